@@ -0,0 +1,141 @@
+#include "ini_file.h"
+#include <windows.h>
+#include <limits.h>
+#include <vector>
+#include "scope_guard.h"
+
+namespace ini {
+
+namespace {
+
+// map whole file read only, returned pointer unmaps view when released
+std::shared_ptr<const void> map_file(const std::wstring& file_path, size_t& size)
+{
+	// no FILE_SHARE_WRITE, nobody can change content under the view
+	HANDLE hFile = ::CreateFile(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(hFile == INVALID_HANDLE_VALUE) {
+		throw std::exception("Could not open file");
+	}
+	scope_guard guard;
+	guard += [&hFile]() {
+		::CloseHandle(hFile);
+	};
+
+	LARGE_INTEGER file_size = { 0 };
+	if(!::GetFileSizeEx(hFile, &file_size)) {
+		throw std::exception("Could not get file size");
+	}
+	size = static_cast<size_t>(file_size.QuadPart);
+	if(size == 0) {
+		// empty file cannot be mapped
+		return nullptr;
+	}
+
+	// view keeps mapping alive, so both handles can be closed right after MapViewOfFile
+	HANDLE hFileMapping = ::CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(hFileMapping == NULL) {
+		throw std::exception("Could not map file");
+	}
+	guard += [&hFileMapping]() {
+		::CloseHandle(hFileMapping);
+	};
+
+	LPVOID lpBaseAddress = ::MapViewOfFile(hFileMapping, FILE_MAP_READ, 0, 0, 0);
+	if(lpBaseAddress == NULL) {
+		throw std::exception("Map view of file fail");
+	}
+	return std::shared_ptr<const void>(lpBaseAddress, [](const void* p) {
+		::UnmapViewOfFile(p);
+	});
+}
+
+// return file content as UTF-16, ANSI and UTF-8 (with BOM) content is converted
+std::shared_ptr<std::vector<wchar_t>> to_utf16(const char* bytes, size_t size)
+{
+	const unsigned char* bom = reinterpret_cast<const unsigned char*>(bytes);
+	auto sp_text = std::make_shared<std::vector<wchar_t>>();
+
+	if(size >= 2 && bom[0] == 0xFF && bom[1] == 0xFE) {
+		// UTF-16 LE, taken as it is
+		if(size % sizeof(wchar_t)) {
+			throw std::exception("Unsupported encoding");
+		}
+		sp_text->assign(reinterpret_cast<const wchar_t*>(bytes), reinterpret_cast<const wchar_t*>(bytes + size));
+		return sp_text;
+	}
+	if(size >= 2 && bom[0] == 0xFE && bom[1] == 0xFF) {
+		// UTF-16 BE
+		throw std::exception("Unsupported encoding");
+	}
+
+	// what WritePrivateProfileString writes to file without BOM
+	UINT code_page = CP_ACP;
+	if(size >= 3 && bom[0] == 0xEF && bom[1] == 0xBB && bom[2] == 0xBF) {
+		code_page = CP_UTF8;
+		bytes += 3;
+		size -= 3;
+	}
+	if(size == 0) {
+		return sp_text;
+	}
+	if(size > INT_MAX) {
+		throw std::exception("File too large");
+	}
+	int length = ::MultiByteToWideChar(code_page, 0, bytes, static_cast<int>(size), nullptr, 0);
+	if(length <= 0) {
+		throw std::exception("Unsupported encoding");
+	}
+	sp_text->resize(length);
+	::MultiByteToWideChar(code_page, 0, bytes, static_cast<int>(size), sp_text->data(), length);
+	return sp_text;
+}
+
+} // end of anonymous namespace
+
+file::file(const std::wstring& file_path, load_mode mode)
+	: m_file_path(file_path)
+	, m_mode(mode)
+{
+	m_snapshot = load(nullptr);
+}
+
+void file::reload()
+{
+	std::lock_guard<std::mutex> reload_lock(m_reload_lock);
+	auto sp_previous = current();
+	auto sp_snapshot = load(sp_previous.get());
+
+	{
+		std::lock_guard<std::mutex> lock(m_snapshot_lock);
+		m_snapshot = sp_snapshot;
+	}
+	// still under reload lock, so subscribers see reloads in order
+	m_reload_registrations.notify_all(sp_previous, sp_snapshot);
+}
+
+std::shared_ptr<const snapshot> file::current() const
+{
+	std::lock_guard<std::mutex> lock(m_snapshot_lock);
+	return m_snapshot;
+}
+
+std::shared_ptr<registration::registrator_intf> file::subscribe(reload_fn&& fn)
+{
+	return m_reload_registrations.subscribe(std::move(fn));
+}
+
+std::shared_ptr<const snapshot> file::load(const snapshot* previous) const
+{
+	size_t size = 0;
+	auto sp_view = map_file(m_file_path, size);
+
+	// snapshot owns copy of the content, view is released right away so writers are not blocked
+	// and sections parsed later (lazy mode) still see content the index was built from
+	auto sp_text = to_utf16(static_cast<const char*>(sp_view.get()), sp_view ? size : 0);
+	sp_view.reset();
+
+	std::shared_ptr<const void> sp_data(sp_text, sp_text->data());
+	return std::make_shared<snapshot>(std::move(sp_data), sp_text->size() * sizeof(wchar_t), m_mode, previous);
+}
+
+} // end of namespace ini
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "snapshot.h"
+#include "registration_holder.h"
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace ini {
+
+// called after reload with previous and new snapshot
+using reload_fn = std::function<void(const std::shared_ptr<const snapshot>& old_snapshot, const std::shared_ptr<const snapshot>& new_snapshot)>;
+
+//////////////////////////////////////////////////////////////////////////
+// Ini file, keeps the current snapshot of its content. Readers take snapshot
+// by current() and keep it as long as they need, reload swaps in a new one
+// (unchanged sections are not parsed again).
+// Each snapshot owns private copy of the file content (file is mapped only
+// while copying), so memory is paid per process and per snapshot kept alive.
+// In exchange old snapshots cannot see later writes and writers are not
+// blocked by open view (ERROR_USER_MAPPED_FILE).
+//////////////////////////////////////////////////////////////////////////
+class file
+{
+public:
+	explicit file(const std::wstring& file_path, load_mode mode = load_mode::full);
+
+	/*! \brief Read file again and build new snapshot from it
+		\throw std::exception when file cannot be read (e.g. it is just being saved), current snapshot stays untouched
+	*/
+	void reload();
+	std::shared_ptr<const snapshot> current() const;
+
+	std::shared_ptr<registration::registrator_intf> subscribe(reload_fn&& fn);
+
+private:
+	std::shared_ptr<const snapshot> load(const snapshot* previous) const;
+
+private:
+	std::wstring                    m_file_path;
+	load_mode                       m_mode = load_mode::full;
+	// serialize reloads
+	std::mutex                      m_reload_lock;
+	mutable std::mutex              m_snapshot_lock;
+	std::shared_ptr<const snapshot> m_snapshot;
+	registration::holder_void<const std::shared_ptr<const snapshot>&, const std::shared_ptr<const snapshot>&> m_reload_registrations;
+};
+
+} // end of namespace ini
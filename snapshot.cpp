@@ -0,0 +1,260 @@
+#include "snapshot.h"
+#include "crc32.h"
+#include <atomic>
+#include <assert.h>
+#include <wchar.h>
+
+namespace ini {
+
+namespace {
+
+const wchar_t utf16_bom = 0xFEFF;
+
+bool is_blank(wchar_t ch)
+{
+	return ch == L' ' || ch == L'\t' || ch == L'\r';
+}
+
+// return end of current line (position of '\n' or end)
+const wchar_t* line_end(const wchar_t* pos, const wchar_t* end)
+{
+	while(pos < end && *pos != L'\n') {
+		++pos;
+	}
+	return pos;
+}
+
+std::wstring trimmed(const wchar_t* begin, const wchar_t* end)
+{
+	while(begin < end && is_blank(*begin)) {
+		++begin;
+	}
+	while(end > begin && is_blank(*(end - 1))) {
+		--end;
+	}
+	return std::wstring(begin, end);
+}
+
+// return true and fill name when line is section header "[name]"
+bool parse_header(const wchar_t* begin, const wchar_t* end, std::wstring& name)
+{
+	while(begin < end && is_blank(*begin)) {
+		++begin;
+	}
+	if(begin == end || *begin != L'[') {
+		return false;
+	}
+	const wchar_t* close = begin + 1;
+	while(close < end && *close != L']') {
+		++close;
+	}
+	if(close == end) {
+		return false;
+	}
+	name = trimmed(begin + 1, close);
+	return true;
+}
+
+} // end of anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////
+bool no_case_less::operator()(const std::wstring& left, const std::wstring& right) const
+{
+	return ::_wcsicmp(left.c_str(), right.c_str()) < 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+section::section(const wchar_t* begin, const wchar_t* end)
+{
+	const wchar_t* pos = begin;
+	while(pos < end) {
+		const wchar_t* eol = line_end(pos, end);
+		const wchar_t* line = pos;
+		while(line < eol && is_blank(*line)) {
+			++line;
+		}
+		if(line < eol && *line != L';' && *line != L'#') {
+			const wchar_t* separator = line;
+			while(separator < eol && *separator != L'=') {
+				++separator;
+			}
+			if(separator < eol) {
+				// first occurrence wins (same as GetPrivateProfileString)
+				m_values.emplace(trimmed(line, separator), trimmed(separator + 1, eol));
+			}
+		}
+		pos = (eol < end) ? eol + 1 : eol;
+	}
+}
+
+const wchar_t* section::value(const wchar_t* value_name) const
+{
+	const auto& item = m_values.find(value_name);
+	if(item == m_values.end()) {
+		return nullptr;
+	}
+	return item->second.c_str();
+}
+
+//////////////////////////////////////////////////////////////////////////
+snapshot::snapshot(std::shared_ptr<const void> data, size_t size, load_mode mode, const snapshot* previous)
+	: m_data(std::move(data))
+	, m_mode(mode)
+{
+	if(size % sizeof(wchar_t)) {
+		// not UTF-16, ini::file converts other encodings before
+		throw std::exception("Unsupported encoding");
+	}
+	m_text = static_cast<const wchar_t*>(m_data.get());
+	m_text_length = m_text ? size / sizeof(wchar_t) : 0;
+	if(m_text_length && *m_text == utf16_bom) {
+		++m_text;
+		--m_text_length;
+	}
+	if(previous) {
+		m_version = previous->version() + 1;
+	}
+
+	build_index();
+
+	for(auto& entry : m_sections) {
+		if(previous) {
+			// unchanged section, take over already parsed form (if any)
+			const section_entry* prev_entry = previous->find_entry(entry.name.c_str());
+			if(prev_entry && same_body(*prev_entry, entry)) {
+				std::atomic_store(&entry.parsed, std::atomic_load(&prev_entry->parsed));
+			}
+		}
+		if(m_mode == load_mode::full && !entry.parsed) {
+			entry.parsed = parse_entry(entry);
+		}
+	}
+}
+
+bool snapshot::same_body(const section_entry& left, const section_entry& right)
+{
+	return left.crc32 == right.crc32 && left.length == right.length;
+}
+
+void snapshot::build_index()
+{
+	const wchar_t* begin = m_text;
+	const wchar_t* end = m_text + m_text_length;
+	const wchar_t* pos = begin;
+	section_entry* current = nullptr;
+
+	auto close_current = [&](const wchar_t* section_end) {
+		if(current) {
+			current->length = (section_end - begin) - current->offset;
+			current->crc32 = crc32(begin + current->offset, current->length * sizeof(wchar_t));
+			current = nullptr;
+		}
+	};
+
+	std::wstring name;
+	while(pos < end) {
+		const wchar_t* eol = line_end(pos, end);
+		const wchar_t* next = (eol < end) ? eol + 1 : eol;
+		if(parse_header(pos, eol, name)) {
+			close_current(pos);
+			if(m_section_index.find(name) == m_section_index.end()) {
+				m_section_index.emplace(name, m_sections.size());
+				m_sections.emplace_back();
+				current = &m_sections.back();
+				current->name = name;
+				current->offset = next - begin;
+			}
+		}
+		pos = next;
+	}
+	close_current(end);
+}
+
+const snapshot::section_entry* snapshot::find_entry(const wchar_t* section_name) const
+{
+	const auto& item = m_section_index.find(section_name);
+	if(item == m_section_index.end()) {
+		return nullptr;
+	}
+	return &m_sections[item->second];
+}
+
+std::shared_ptr<const section> snapshot::parse_entry(const section_entry& entry) const
+{
+	const wchar_t* begin = m_text + entry.offset;
+	// watcher diffs old snapshots long after load, they have to parse content the index was built from
+	assert(crc32(begin, entry.length * sizeof(wchar_t)) == entry.crc32 && "Snapshot data changed after load");
+	return std::make_shared<section>(begin, begin + entry.length);
+}
+
+std::shared_ptr<const section> snapshot::get_section(const wchar_t* section_name) const
+{
+	const section_entry* entry = find_entry(section_name);
+	if(!entry) {
+		return nullptr;
+	}
+	auto sp_section = std::atomic_load(&entry->parsed);
+	if(sp_section) {
+		return sp_section;
+	}
+
+	std::lock_guard<std::mutex> lock(m_parse_lock);
+	// other thread could parse it meanwhile
+	sp_section = std::atomic_load(&entry->parsed);
+	if(!sp_section) {
+		sp_section = parse_entry(*entry);
+		std::atomic_store(&entry->parsed, sp_section);
+	}
+	return sp_section;
+}
+
+std::shared_ptr<const std::wstring> snapshot::get_value(const wchar_t* section_name, const wchar_t* value_name) const
+{
+	auto sp_section = get_section(section_name);
+	if(!sp_section) {
+		return nullptr;
+	}
+	const auto& values = sp_section->values();
+	const auto& item = values.find(value_name);
+	if(item == values.end()) {
+		return nullptr;
+	}
+	// aliasing constructor, value lives as long as its section
+	return std::shared_ptr<const std::wstring>(sp_section, &item->second);
+}
+
+bool snapshot::has_section(const wchar_t* section_name) const
+{
+	return find_entry(section_name) != nullptr;
+}
+
+bool snapshot::section_parsed(const wchar_t* section_name) const
+{
+	const section_entry* entry = find_entry(section_name);
+	return entry && std::atomic_load(&entry->parsed) != nullptr;
+}
+
+uint32_t snapshot::section_crc32(const wchar_t* section_name) const
+{
+	const section_entry* entry = find_entry(section_name);
+	return entry ? entry->crc32 : 0;
+}
+
+bool snapshot::same_section(const wchar_t* section_name, const snapshot& other) const
+{
+	const section_entry* entry = find_entry(section_name);
+	const section_entry* other_entry = other.find_entry(section_name);
+	return entry && other_entry && same_body(*entry, *other_entry);
+}
+
+std::vector<std::wstring> snapshot::section_names() const
+{
+	std::vector<std::wstring> names;
+	names.reserve(m_sections.size());
+	for(const auto& entry : m_sections) {
+		names.push_back(entry.name);
+	}
+	return names;
+}
+
+} // end of namespace ini
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ini {
+
+enum class load_mode {
+	full, // parse all sections while loading
+	lazy  // only index sections while loading, parse each one on first access
+};
+
+// section and value names are case insensitive (same as GetPrivateProfileString)
+struct no_case_less {
+	bool operator()(const std::wstring& left, const std::wstring& right) const;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Parsed content of one section, immutable once created
+//////////////////////////////////////////////////////////////////////////
+class section
+{
+public:
+	using value_map = std::map<std::wstring, std::wstring, no_case_less>;
+
+	section(const wchar_t* begin, const wchar_t* end);
+
+	// return nullptr when value does not exist
+	const wchar_t* value(const wchar_t* value_name) const;
+	const value_map& values() const { return m_values; }
+
+private:
+	value_map m_values;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// One loaded state of ini file. Snapshot keeps its data alive, so sections
+// which were not parsed yet (lazy mode) can be parsed later from any thread.
+// Data must not change during snapshot life (do not pass live file view).
+//////////////////////////////////////////////////////////////////////////
+class snapshot
+{
+public:
+	/*! \brief Build snapshot from UTF-16 ini file content
+		\param [in]	data		file content (BOM is optional), snapshot holds reference to it, content must stay unchanged
+		\param [in]	size		size of data in bytes, has to be multiple of sizeof(wchar_t)
+		\param [in]	mode		full or lazy section parsing
+		\param [in]	previous	previous snapshot (or nullptr), unchanged sections (same crc32) reuse its parsed form
+		\throw std::exception when size is not whole number of characters
+	*/
+	snapshot(std::shared_ptr<const void> data, size_t size, load_mode mode, const snapshot* previous = nullptr);
+
+	snapshot(const snapshot&) = delete;
+	snapshot& operator = (const snapshot&) = delete;
+
+	uint64_t version() const { return m_version; }
+	load_mode mode() const { return m_mode; }
+
+	// return nullptr when section does not exist, section is parsed here when it was not accessed yet
+	std::shared_ptr<const section> get_section(const wchar_t* section_name) const;
+	// return nullptr when section or value does not exist
+	std::shared_ptr<const std::wstring> get_value(const wchar_t* section_name, const wchar_t* value_name) const;
+
+	bool has_section(const wchar_t* section_name) const;
+	// true when section was already parsed (or taken over from previous snapshot), for diagnostics
+	bool section_parsed(const wchar_t* section_name) const;
+	// crc32 of section body as found in file, 0 when section does not exist
+	uint32_t section_crc32(const wchar_t* section_name) const;
+	std::vector<std::wstring> section_names() const;
+	// true when section exists in both snapshots with the same body (its parsed form is shared)
+	bool same_section(const wchar_t* section_name, const snapshot& other) const;
+
+private:
+	struct section_entry {
+		std::wstring                           name;
+		size_t                                 offset = 0; // in characters, first character after header line
+		size_t                                 length = 0; // in characters
+		uint32_t                               crc32 = 0;
+		mutable std::shared_ptr<const section> parsed;     // access only by std::atomic_load/store
+	};
+
+	static bool same_body(const section_entry& left, const section_entry& right);
+	void build_index();
+	const section_entry* find_entry(const wchar_t* section_name) const;
+	std::shared_ptr<const section> parse_entry(const section_entry& entry) const;
+
+private:
+	std::shared_ptr<const void>                  m_data;
+	const wchar_t*                               m_text = nullptr;
+	size_t                                       m_text_length = 0;
+	load_mode                                    m_mode = load_mode::full;
+	uint64_t                                     m_version = 1;
+	std::vector<section_entry>                   m_sections;
+	// section name -> index into m_sections (first occurrence wins)
+	std::map<std::wstring, size_t, no_case_less> m_section_index;
+	// serialize parsing of not yet accessed sections
+	mutable std::mutex                           m_parse_lock;
+};
+
+} // end of namespace ini
@@ -1,14 +1,155 @@
 #include "watcher.h"
+#include <algorithm>
 
 namespace ini {
 
-void watcher::subscribe(const wchar_t* section, const wchar_t* value_name, change_fn&& fn)
+namespace {
+
+// append values which differ between old and new section (any of them can be nullptr)
+void diff_section(const std::wstring& section_name, const section* old_section, const section* new_section, std::vector<changed_value>& changed)
+{
+	static const section::value_map empty;
+	const auto& old_values = old_section ? old_section->values() : empty;
+	const auto& new_values = new_section ? new_section->values() : empty;
+
+	// both maps are sorted by the same (case insensitive) order, walk them together
+	const auto less = new_values.key_comp();
+	auto old_it = old_values.begin();
+	auto new_it = new_values.begin();
+	while(old_it != old_values.end() || new_it != new_values.end()) {
+		if(new_it == new_values.end() || (old_it != old_values.end() && less(old_it->first, new_it->first))) {
+			changed.push_back({ section_name, old_it->first });
+			++old_it;
+		} else if(old_it == old_values.end() || less(new_it->first, old_it->first)) {
+			changed.push_back({ section_name, new_it->first });
+			++new_it;
+		} else {
+			if(old_it->second != new_it->second) {
+				changed.push_back({ section_name, new_it->first });
+			}
+			++old_it;
+			++new_it;
+		}
+	}
+}
+
+} // end of anonymous namespace
+
+watcher::watcher(file& source)
+{
+	m_reload_token = source.subscribe([this](const std::shared_ptr<const snapshot>& old_snapshot, const std::shared_ptr<const snapshot>& new_snapshot) {
+		on_reload(old_snapshot, new_snapshot);
+	});
+}
+
+std::shared_ptr<registration::registrator_intf> watcher::subscribe(batch_change_fn&& fn)
 {
+	auto sp_subscribers = m_batch_subscribers;
+	++*sp_subscribers;
+	return m_batch_registrations.subscribe(std::move(fn), [sp_subscribers]() {
+		--*sp_subscribers;
+	});
+}
 
+void watcher::subscribe(const wchar_t* section, const wchar_t* value_name, change_fn&& fn)
+{
+	// may replace callback which is just running
+	std::lock_guard<std::recursive_mutex> notification_lock(m_notification_lock);
+	std::lock_guard<std::mutex> lock(m_subscriptions_lock);
+	m_subscriptions[section][value_name] = std::move(fn);
 }
 
 void watcher::unsubscribe(const wchar_t* section, const wchar_t* value_name)
 {
+	// wait for running notification, callback must not be called after return
+	std::lock_guard<std::recursive_mutex> notification_lock(m_notification_lock);
+	std::lock_guard<std::mutex> lock(m_subscriptions_lock);
+	const auto& item = m_subscriptions.find(section);
+	if(item == m_subscriptions.end()) {
+		return;
+	}
+	item->second.erase(value_name);
+	if(item->second.empty()) {
+		m_subscriptions.erase(item);
+	}
+}
+
+void watcher::on_reload(const std::shared_ptr<const snapshot>& old_snapshot, const std::shared_ptr<const snapshot>& new_snapshot)
+{
+	const bool batch_subscribed = *m_batch_subscribers > 0;
+
+	// sections to compare, per value subscribers alone need just sections they watch
+	std::vector<std::wstring> sections;
+	if(batch_subscribed) {
+		sections = new_snapshot->section_names();
+		for(const auto& name : old_snapshot->section_names()) {
+			if(!new_snapshot->has_section(name.c_str())) {
+				sections.push_back(name);
+			}
+		}
+	} else {
+		std::lock_guard<std::mutex> lock(m_subscriptions_lock);
+		for(const auto& item : m_subscriptions) {
+			sections.push_back(item.first);
+		}
+	}
+	if(!batch_subscribed && sections.empty()) {
+		return;
+	}
+
+	change_event event;
+	event.old_version = old_snapshot->version();
+	event.new_version = new_snapshot->version();
+
+	// only changed sections are parsed and compared
+	for(const auto& name : sections) {
+		if(!old_snapshot->has_section(name.c_str()) && !new_snapshot->has_section(name.c_str())) {
+			continue;
+		}
+		if(new_snapshot->same_section(name.c_str(), *old_snapshot)) {
+			continue;
+		}
+		auto sp_old = old_snapshot->get_section(name.c_str());
+		auto sp_new = new_snapshot->get_section(name.c_str());
+		diff_section(name, sp_old.get(), sp_new.get(), event.changed);
+	}
+
+	std::sort(event.changed.begin(), event.changed.end(), [](const changed_value& left, const changed_value& right) {
+		const no_case_less less;
+		if(less(left.section, right.section)) {
+			return true;
+		}
+		return !less(right.section, left.section) && less(left.value_name, right.value_name);
+	});
+
+	if(batch_subscribed) {
+		m_batch_registrations.notify_all(event);
+	}
+	if(!event.changed.empty()) {
+		on_change(event);
+	}
+}
+
+void watcher::on_change(const change_event& event)
+{
+	std::lock_guard<std::recursive_mutex> notification_lock(m_notification_lock);
+	for(const auto& change : event.changed) {
+		// look up each time, previous callback could (un)subscribe
+		change_fn fn;
+		{
+			std::lock_guard<std::mutex> lock(m_subscriptions_lock);
+			const auto& section_item = m_subscriptions.find(change.section);
+			if(section_item == m_subscriptions.end()) {
+				continue;
+			}
+			const auto& value_item = section_item->second.find(change.value_name);
+			if(value_item == section_item->second.end()) {
+				continue;
+			}
+			fn = value_item->second;
+		}
+		fn(change.section.c_str(), change.value_name.c_str());
+	}
 }
 
-} // end of namespace ini
\ No newline at end of file
+} // end of namespace ini
@@ -1,30 +1,67 @@
 #pragma once
 
 #include <stdint.h>
+#include <atomic>
 #include <functional>
 #include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ini_file.h"
 
 namespace ini {
 
+struct changed_value {
+	std::wstring section;
+	std::wstring value_name;
+};
+
+// one event per reload (also when nothing changed), so new_version of one event
+// is always old_version of the next one
+struct change_event {
+	uint64_t                   old_version = 0;
+	uint64_t                   new_version = 0;
+	// added, removed or modified values, sorted by section and value name
+	std::vector<changed_value> changed;
+};
 
 using change_fn = std::function<void(const wchar_t* section, const wchar_t* value_name)>;
+using batch_change_fn = std::function<void(const change_event& event)>;
 
 class watcher
 {
 public:
+	/*! \brief Watch reloads of given file
+		\param [in]	source	file to watch, it has to outlive the watcher (watcher keeps subscription in it)
+	*/
+	explicit watcher(file& source);
+
+	// whole reload at once, keep returned token to stay subscribed
+	std::shared_ptr<registration::registrator_intf> subscribe(batch_change_fn&& fn);
+
+	// per value callbacks, dispatched from the same change event as batch subscription
 	void subscribe(const wchar_t* section, const wchar_t* value_name, change_fn&& fn);
+	// after return the callback is guaranteed not to be called any more
 	void unsubscribe(const wchar_t* section, const wchar_t* value_name);
 
 private:
-	struct value_subs {
-		uint32_t  crc32 = 0;
-		change_fn fn = nullptr;
-	};
-	// value map is represent by value name and crc32 of value
-	using value_map = std::map<std::wstring, value_subs>;
-	// held all subscriptions
-	std::map<std::wstring, value_map> m_subscriptions;
+	void on_reload(const std::shared_ptr<const snapshot>& old_snapshot, const std::shared_ptr<const snapshot>& new_snapshot);
+	void on_change(const change_event& event);
+
+private:
+	// value map is represent by value name and its callback
+	using value_map = std::map<std::wstring, change_fn, no_case_less>;
+	registration::holder_void<const change_event&>  m_batch_registrations;
+	// live batch tokens, holder keeps released ones until next subscribe (shared, token may outlive watcher)
+	std::shared_ptr<std::atomic<size_t>>            m_batch_subscribers = std::make_shared<std::atomic<size_t>>(0);
+	// held while per value callbacks run, (un)subscribe waits for it (recursive, callback may unsubscribe itself)
+	std::recursive_mutex                            m_notification_lock;
+	// held all per value subscriptions
+	std::mutex                                      m_subscriptions_lock;
+	std::map<std::wstring, value_map, no_case_less> m_subscriptions;
+	// token last, it has to be released before the members above
+	std::shared_ptr<registration::registrator_intf> m_reload_token;
 };
 
 
-} // end of namespace ini
\ No newline at end of file
+} // end of namespace ini